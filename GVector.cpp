@@ -123,6 +123,79 @@ ostream& operator<< (ostream& out, const GVector& v) {
 
 
 
+/* Batched dot products. */
+void batchDot(const GVectorSpan& a, const GVectorSpan& b, double* out) {
+    for (size_t i = 0; i < a.size; i++) {
+        out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i];
+    }
+}
+
+/* Batched rotation. The angle is fixed across the batch, so the sines and
+ * cosines hoist out of the loop and the body reduces to four multiplies and
+ * two adds per element.
+ */
+void batchRotate(const GVectorSpan& v, double theta, double* outX, double* outY) {
+    double cosTheta = cos(theta);
+    double sinTheta = sin(theta);
+
+    for (size_t i = 0; i < v.size; i++) {
+        outX[i] = v.x[i] * cosTheta - v.y[i] * sinTheta;
+        outY[i] = v.x[i] * sinTheta + v.y[i] * cosTheta;
+    }
+}
+
+/* Batched normalization. */
+void batchNormalize(const GVectorSpan& v, double* outX, double* outY) {
+    for (size_t i = 0; i < v.size; i++) {
+        double scale = 1.0 / sqrt(v.x[i] * v.x[i] + v.y[i] * v.y[i]);
+        outX[i] = v.x[i] * scale;
+        outY[i] = v.y[i] * scale;
+    }
+}
+
+/* Batched line/circle intersection counting.
+ *
+ * Any point (x, y) on a circle satisfies
+ *
+ *    (x - x_c)^2 + (y - y_c)^2 = r^2.
+ *
+ * Any point on the line from p0 to p1 has parametric form
+ *
+ *    (x(t), y(t)) = p0 + t(p1 - p0).
+ *
+ * Substituting and isolating t yields the quadratic
+ *
+ *    dot(d, d) t^2 + 2 dot(d, s) t + (dot(s, s) - r^2) = 0
+ *
+ * where d = p1 - p0 and s = p0 - center. The segment hits the circle if
+ * solutions exist, UNLESS both are less than zero or both are greater than
+ * one (the infinite line hits but the segment misses on one side).
+ */
+size_t countCircleSegmentHits(double centerX, double centerY, double radius,
+                              const GVectorSpan& from, const GVectorSpan& to) {
+    size_t hits = 0;
+    for (size_t i = 0; i < from.size; i++) {
+        double dx = to.x[i] - from.x[i];
+        double dy = to.y[i] - from.y[i];
+        double sx = from.x[i] - centerX;
+        double sy = from.y[i] - centerY;
+
+        double a = dx * dx + dy * dy;
+        double b = 2 * (dx * sx + dy * sy);
+        double c = sx * sx + sy * sy - radius * radius;
+
+        double discriminant = b * b - 4 * a * c;
+        if (discriminant < 0) continue;
+
+        double root = sqrt(discriminant);
+        double t1 = (-b + root) / (2 * a);
+        double t2 = (-b - root) / (2 * a);
+
+        hits += !((t1 < 0 && t2 < 0) || (t1 > 1 && t2 > 1));
+    }
+    return hits;
+}
+
 GVector operator* (const GMatrix& m, const GVector& v) {
     return { m.a * v.x + m.b * v.y, m.c * v.x + m.d * v.y };
 }
@@ -3,6 +3,7 @@
 
 #include "gobjects.h"
 #include <ostream>
+#include <cstddef>
 
 /* Type representing a 2D vector. */
 struct GVector {
@@ -72,6 +73,34 @@ struct GMatrix {
     GMatrix(const GVector& col1, const GVector& col2): a(col1.x), b(col2.x), c(col1.y), d(col2.y) {}
 };
 
+/* Structure-of-arrays view over a sequence of 2D vectors or points. The
+ * batched operations below run over these rather than over arrays of GVector
+ * so that their inner loops touch contiguous doubles and autovectorize.
+ */
+struct GVectorSpan {
+    const double* x;
+    const double* y;
+    std::size_t size;
+};
+
+/* Batched dot products: out[i] = dot(a[i], b[i]). The spans must be the
+ * same size.
+ */
+void batchDot(const GVectorSpan& a, const GVectorSpan& b, double* out);
+
+/* Batched rotation by a fixed angle: (outX[i], outY[i]) = rotate(v[i], theta). */
+void batchRotate(const GVectorSpan& v, double theta, double* outX, double* outY);
+
+/* Batched normalization: (outX[i], outY[i]) = normalizationOf(v[i]). */
+void batchNormalize(const GVectorSpan& v, double* outX, double* outY);
+
+/* Counts how many of the given segments (from[i] to to[i], treated as points)
+ * intersect the circle with the given center and radius. This is the batched
+ * form of the line/circle collision test used for graph layout.
+ */
+std::size_t countCircleSegmentHits(double centerX, double centerY, double radius,
+                                   const GVectorSpan& from, const GVectorSpan& to);
+
 GVector operator* (const GMatrix& m, const GVector& v);
 GPoint  operator* (const GMatrix& m, const GPoint& v);
 GMatrix operator* (const GMatrix& m, const GMatrix& n);
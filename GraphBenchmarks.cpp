@@ -0,0 +1,285 @@
+/******************************************************************************
+ * Benchmark harness for the graph viewer's hot paths: edge endpoint
+ * recomputation, point queries, serialization in all three formats, and the
+ * draw path run headlessly against a null canvas.
+ *
+ * This is a standalone tool, not part of the editor. Build it against the
+ * project sources (it supplies its own main) and run it from the command
+ * line; timings print to stdout in a fixed-width table so that runs can be
+ * diffed across releases.
+ */
+#include "GraphViewer.h"
+#include "GVector.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+
+using namespace GraphEditor;
+
+namespace {
+    /* Bounds used for every benchmark; matches a 1000x600 window. */
+    const GRectangle kBenchBounds = { 0, 0, 1000, 600 };
+
+    /* Margin kept between generated nodes and the world edge. */
+    const double kMargin = 0.05;
+
+    /* Small deterministic PRNG so that runs are comparable; no seeding from
+     * the clock on purpose.
+     */
+    struct Random {
+        unsigned state = 0x2F6E2B1;
+
+        double next01() {
+            state = state * 1664525 + 1013904223;
+            return (state >> 8) / double(1 << 24);
+        }
+    };
+
+    /* Wall-clock time of one run of the callback, in milliseconds. */
+    template <typename Callback>
+    double timeOf(Callback callback) {
+        auto start = std::chrono::steady_clock::now();
+        callback();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+
+    void report(const std::string& name, double ms) {
+        std::cout << std::left  << std::setw(52) << name
+                  << std::right << std::setw(12)
+                  << std::fixed << std::setprecision(3) << ms
+                  << " ms" << std::endl;
+    }
+
+    void heading(const std::string& title) {
+        std::cout << std::endl << "=== " << title << " ===" << std::endl;
+    }
+
+    /* Generator: rows x cols lattice with edges to the right and down.
+     * Representative of circuit-ish layouts: short edges, no self-loops.
+     */
+    std::shared_ptr<Viewer<>> makeGrid(std::size_t rows, std::size_t cols) {
+        auto viewer = std::make_shared<Viewer<>>();
+        viewer->setBounds(kBenchBounds);
+
+        ViewerBase::BatchUpdate update(viewer.get());
+
+        std::vector<std::vector<Node*>> nodes(rows, std::vector<Node*>(cols));
+        double worldHeight = 1.0 / viewer->aspectRatio();
+        for (std::size_t r = 0; r < rows; r++) {
+            for (std::size_t c = 0; c < cols; c++) {
+                GPoint pos = {
+                    kMargin + (1 - 2 * kMargin) * (cols == 1? 0.5 : c / double(cols - 1)),
+                    kMargin + (worldHeight - 2 * kMargin) * (rows == 1? 0.5 : r / double(rows - 1))
+                };
+                nodes[r][c] = viewer->newNode(pos);
+                nodes[r][c]->label(std::to_string(r * cols + c));
+            }
+        }
+        for (std::size_t r = 0; r < rows; r++) {
+            for (std::size_t c = 0; c < cols; c++) {
+                if (c + 1 < cols) viewer->newEdge(nodes[r][c], nodes[r][c + 1]);
+                if (r + 1 < rows) viewer->newEdge(nodes[r][c], nodes[r + 1][c]);
+            }
+        }
+        return viewer;
+    }
+
+    /* Generator: n nodes on a circle, every pair connected. Representative of
+     * dense graphs where every node move touches many edges.
+     */
+    std::shared_ptr<Viewer<>> makeClique(std::size_t n) {
+        auto viewer = std::make_shared<Viewer<>>();
+        viewer->setBounds(kBenchBounds);
+
+        ViewerBase::BatchUpdate update(viewer.get());
+
+        double worldHeight = 1.0 / viewer->aspectRatio();
+        GPoint center = { 0.5, worldHeight / 2 };
+        double radius = worldHeight / 2 - kMargin;
+
+        std::vector<Node*> nodes;
+        for (std::size_t i = 0; i < n; i++) {
+            double theta = 2 * M_PI * i / n;
+            nodes.push_back(viewer->newNode(center + unitToward(theta) * radius));
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            for (std::size_t j = i + 1; j < n; j++) {
+                viewer->newEdge(nodes[i], nodes[j]);
+            }
+        }
+        return viewer;
+    }
+
+    /* Generator: a ring of n states, each with a labeled transition to the
+     * next and a self-loop. Representative of automata, and the heaviest
+     * exercise of self-loop placement.
+     */
+    std::shared_ptr<Viewer<>> makeStateMachine(std::size_t n) {
+        auto viewer = std::make_shared<Viewer<>>();
+        viewer->setBounds(kBenchBounds);
+
+        ViewerBase::BatchUpdate update(viewer.get());
+
+        double worldHeight = 1.0 / viewer->aspectRatio();
+        GPoint center = { 0.5, worldHeight / 2 };
+        double radius = worldHeight / 2 - kMargin;
+
+        std::vector<Node*> nodes;
+        for (std::size_t i = 0; i < n; i++) {
+            double theta = 2 * M_PI * i / n;
+            auto* node = viewer->newNode(center + unitToward(theta) * radius);
+            node->label("q" + std::to_string(i));
+            nodes.push_back(node);
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            viewer->newEdge(nodes[i], nodes[(i + 1) % n], "a");
+            viewer->newEdge(nodes[i], nodes[i], "b");
+        }
+        return viewer;
+    }
+
+    /* Timed cases, each run against a prebuilt viewer. */
+
+    void benchConstruction() {
+        heading("Construction (includes one batched endpoint computation)");
+        report("grid 16x16 (256 V, 480 E)",       timeOf([] { makeGrid(16, 16); }));
+        report("grid 40x40 (1600 V, 3120 E)",     timeOf([] { makeGrid(40, 40); }));
+        report("clique 40 (40 V, 780 E)",         timeOf([] { makeClique(40); }));
+        report("state machine 200 (200 V, 400 E)", timeOf([] { makeStateMachine(200); }));
+    }
+
+    void benchEndpointRecomputation() {
+        heading("Edge endpoint recomputation");
+
+        auto grid = makeGrid(32, 32);
+        auto machine = makeStateMachine(200);
+
+        /* Adding and removing an edge each trigger the full recompute. */
+        {
+            auto* a = grid->nodeLabeled("0");
+            auto* b = grid->nodeLabeled("1023");
+            report("full recompute x100 (grid 32x32)", timeOf([&] {
+                for (int i = 0; i < 50; i++) {
+                    auto* edge = grid->newEdge(a, b);
+                    grid->removeEdge(edge);
+                }
+            }));
+        }
+
+        /* Dragging a node triggers the incremental path. */
+        {
+            auto* node = machine->nodeLabeled("q0");
+            GPoint home = node->position();
+            report("incremental recompute x1000 (node drag)", timeOf([&] {
+                for (int i = 0; i < 1000; i++) {
+                    node->position(home + GVector{ 0.001 * (i % 7), 0.001 * (i % 5) });
+                }
+                node->position(home);
+            }));
+        }
+    }
+
+    void benchPointQueries() {
+        heading("Point queries");
+
+        auto grid = makeGrid(40, 40);
+        double worldHeight = 1.0 / grid->aspectRatio();
+
+        Random random;
+        report("nodeAt x100000 (grid 40x40)", timeOf([&] {
+            for (int i = 0; i < 100000; i++) {
+                grid->nodeAt({ random.next01(), random.next01() * worldHeight });
+            }
+        }));
+        report("edgeAt x100000 (grid 40x40)", timeOf([&] {
+            for (int i = 0; i < 100000; i++) {
+                grid->edgeAt({ random.next01(), random.next01() * worldHeight });
+            }
+        }));
+    }
+
+    void benchSerialization() {
+        heading("Serialization (grid 40x40)");
+
+        auto grid = makeGrid(40, 40);
+
+        JSON dom = nullptr;
+        report("toJSON (DOM)", timeOf([&] { dom = grid->toJSON(); }));
+
+        std::ostringstream jsonText;
+        report("serialize (streaming JSON)", timeOf([&] { grid->serialize(jsonText); }));
+
+        std::ostringstream binary;
+        report("toBinary", timeOf([&] { grid->toBinary(binary); }));
+
+        heading("Deserialization (grid 40x40)");
+        report("Viewer(JSON) from DOM", timeOf([&] { Viewer<> loaded(dom); }));
+
+        std::istringstream jsonIn(jsonText.str());
+        report("Viewer(istream), streaming JSON", timeOf([&] { Viewer<> loaded(jsonIn); }));
+
+        std::istringstream binaryIn(binary.str());
+        report("Viewer(istream), binary", timeOf([&] { Viewer<> loaded(binaryIn); }));
+    }
+
+    void benchVectorKernels() {
+        heading("Batched GVector kernels (1M points)");
+
+        const std::size_t n = 1000000;
+        Random random;
+        std::vector<double> xs(n), ys(n), outX(n), outY(n), out(n);
+        for (std::size_t i = 0; i < n; i++) {
+            xs[i] = random.next01() * 2 - 1;
+            ys[i] = random.next01() * 2 - 1;
+        }
+        GVectorSpan span{ xs.data(), ys.data(), n };
+
+        report("batchDot",       timeOf([&] { batchDot(span, span, out.data()); }));
+        report("batchRotate",    timeOf([&] { batchRotate(span, M_PI / 3, outX.data(), outY.data()); }));
+        report("batchNormalize", timeOf([&] { batchNormalize(span, outX.data(), outY.data()); }));
+
+        /* Segments from each point to the next, against a circle near the
+         * middle; roughly the shape of a loop-placement collision query.
+         */
+        GVectorSpan from{ xs.data(), ys.data(), n - 1 };
+        GVectorSpan to  { xs.data() + 1, ys.data() + 1, n - 1 };
+        std::size_t hits = 0;
+        report("countCircleSegmentHits", timeOf([&] {
+            hits = countCircleSegmentHits(0.1, 0.1, 0.25, from, to);
+        }));
+        std::cout << "  (" << hits << " hits)" << std::endl;
+    }
+
+    void benchDraw() {
+        heading("Headless draw (null canvas)");
+
+        auto machine = makeStateMachine(200);
+
+        /* First frame pays for text layout; later frames hit the caches. */
+        report("draw, cold caches",  timeOf([&] { machine->draw(nullptr); }));
+        report("draw x100, warm",    timeOf([&] {
+            for (int i = 0; i < 100; i++) machine->draw(nullptr);
+        }));
+
+        machine->renderMode(RenderMode::OVERVIEW);
+        machine->simplificationThreshold(1000); // Force the simplified path.
+        report("draw x100, OVERVIEW simplified", timeOf([&] {
+            for (int i = 0; i < 100; i++) machine->draw(nullptr);
+        }));
+    }
+}
+
+int main() {
+    benchConstruction();
+    benchEndpointRecomputation();
+    benchPointQueries();
+    benchSerialization();
+    benchVectorKernels();
+    benchDraw();
+    return 0;
+}
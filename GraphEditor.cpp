@@ -1,5 +1,6 @@
 #include "GraphEditor.h"
 #include "GVector.h"
+#include <fstream>
 
 namespace GraphEditor {
     namespace {
@@ -19,13 +20,63 @@ namespace GraphEditor {
         const auto kActiveTransitionColor   = MiniGUI::Color::fromHex(0xff950e);
         const double kActiveTransitionWidth = GraphEditor::kEdgeTolerance;
         const auto kHoverTransitionColor    = MiniGUI::Color::BLUE();
+
+        /* World-space rectangle covering the segment from p0 to p1, padded out
+         * far enough to cover line width and arrowheads. Used to report damage
+         * for the in-progress edge drag.
+         */
+        GRectangle rectAround(const GPoint& p0, const GPoint& p1) {
+            double pad = GraphEditor::kEdgeTolerance;
+            double x = std::min(p0.x, p1.x) - pad;
+            double y = std::min(p0.y, p1.y) - pad;
+            return {
+                x, y,
+                std::max(p0.x, p1.x) + pad - x,
+                std::max(p0.y, p1.y) + pad - y
+            };
+        }
     }
 
     EditorBase::EditorBase(std::shared_ptr<ViewerBase> viewer) : mViewer(viewer) {
         // Handled above
     }
 
+    EditorBase::~EditorBase() {
+        /* Let any in-flight save finish; it holds a snapshot, not us, but
+         * the thread itself must be joined before it's destroyed.
+         */
+        if (saveWorker.joinable()) saveWorker.join();
+    }
+
+    void EditorBase::saveAsync(const std::string& filename, FileFormat format) {
+        /* One save at a time; see the header. */
+        if (saveWorker.joinable()) saveWorker.join();
+
+        /* Capture everything the worker needs by value: the snapshot shares
+         * nothing with the live graph, and a copy of the listener roster
+         * insulates the worker from addListener() calls made while it runs.
+         */
+        auto snapshot  = mViewer->snapshot();
+        auto listeners = mListeners;
+        saveWorker = std::thread([snapshot, listeners, filename, format] {
+            std::ofstream out(filename, std::ios::binary);
+            if (format == FileFormat::BINARY) {
+                snapshot.writeBinary(out);
+            } else {
+                snapshot.writeJSON(out);
+            }
+            out.flush();
+
+            bool succeeded = bool(out);
+            for (auto listener: listeners) {
+                listener->saveCompleted(succeeded);
+            }
+        });
+    }
+
     void EditorBase::setActive(Entity* active) {
+        Entity* before = activeNode? static_cast<Entity*>(activeNode) : static_cast<Entity*>(activeEdge);
+
         if (auto* node = dynamic_cast<Node*>(active)) {
             setActiveNode(node);
         } else if (auto* edge = dynamic_cast<Edge*>(active)) {
@@ -35,13 +86,19 @@ namespace GraphEditor {
             setActiveEdge(nullptr);
         }
 
-        /* Let folks know about this one. */
-        for (auto listener: mListeners) {
-            listener->entitySelected(active);
+        /* Let folks know about this one, but only if it's news; re-selecting
+         * the current entity shouldn't fan out to every listener.
+         */
+        if (active != before) {
+            for (auto listener: mListeners) {
+                listener->entitySelected(active);
+            }
         }
     }
 
     void EditorBase::setHover(Entity* hover) {
+        Entity* before = hoverNode? static_cast<Entity*>(hoverNode) : static_cast<Entity*>(hoverEdge);
+
         if (auto* node = dynamic_cast<GraphEditor::Node*>(hover)) {
             setHoverNode(node);
         } else if (auto* edge = dynamic_cast<GraphEditor::Edge*>(hover)) {
@@ -51,46 +108,76 @@ namespace GraphEditor {
             setHoverEdge(nullptr);
         }
 
-        /* Let folks know about this one. */
-        for (auto listener: mListeners) {
-            listener->entityHovered(hover);
+        /* As with selection, only changes are worth announcing. */
+        if (hover != before) {
+            for (auto listener: mListeners) {
+                listener->entityHovered(hover);
+            }
         }
     }
 
     void EditorBase::setActiveNode(Node* state) {
-        if (activeNode != state) requestRepaint();
+        if (activeNode != state) {
+            requestRepaint();
+            mViewer->markDamaged(activeNode);
+            mViewer->markDamaged(state);
+        }
         activeNode = state;
 
         if (activeNode) {
+            mViewer->markDamaged(activeEdge);
             activeEdge = nullptr;
         }
+
+        rebuildOverlay();
     }
 
     void EditorBase::setActiveEdge(Edge* transition) {
-        if (activeEdge != transition) requestRepaint();
+        if (activeEdge != transition) {
+            requestRepaint();
+            mViewer->markDamaged(activeEdge);
+            mViewer->markDamaged(transition);
+        }
         activeEdge = transition;
 
         if (activeEdge != nullptr) {
+            mViewer->markDamaged(activeNode);
             activeNode = nullptr;
         }
+
+        rebuildOverlay();
     }
 
     void EditorBase::setHoverNode(Node* state) {
-        if (hoverNode != state) requestRepaint();
+        if (hoverNode != state) {
+            requestRepaint();
+            mViewer->markDamaged(hoverNode);
+            mViewer->markDamaged(state);
+        }
         hoverNode = state;
 
         if (hoverNode) {
+            mViewer->markDamaged(hoverEdge);
             hoverEdge = nullptr;
         }
+
+        rebuildOverlay();
     }
 
     void EditorBase::setHoverEdge(Edge* transition) {
-        if (hoverEdge != transition) requestRepaint();
+        if (hoverEdge != transition) {
+            requestRepaint();
+            mViewer->markDamaged(hoverEdge);
+            mViewer->markDamaged(transition);
+        }
         hoverEdge = transition;
 
         if (hoverEdge) {
+            mViewer->markDamaged(hoverNode);
             hoverNode = nullptr;
         }
+
+        rebuildOverlay();
     }
 
     void EditorBase::mouseDoubleClicked(double x, double y) {
@@ -111,12 +198,28 @@ namespace GraphEditor {
         dirty();
     }
 
+    namespace {
+        bool isCloseTo(GPoint p0, GPoint p1, double distance) {
+            double dx = p0.x - p1.x;
+            double dy = p0.y - p1.y;
+
+            return dx * dx + dy * dy <= distance * distance;
+        }
+    }
+
     void EditorBase::mouseMoved(double x, double y) {
         /* Skip this if we're dragging the mouse. */
         if (dragType != DragType::NONE) return;
 
         GPoint pt = mViewer->graphicsToWorld(GPoint{x, y});
 
+        /* Sub-epsilon jitter can't change what we're hovering over enough to
+         * matter; don't re-run hit testing for it.
+         */
+        if (hasLastHitTest && isCloseTo(pt, lastHitTest, mHoverEpsilon)) return;
+        hasLastHitTest = true;
+        lastHitTest = pt;
+
         /* See if we hit a state. */
         if (auto over = mViewer->nodeAt(pt)) {
             setHover(over);
@@ -127,15 +230,6 @@ namespace GraphEditor {
         }
     }
 
-    namespace {
-        bool isCloseTo(GPoint p0, GPoint p1, double distance) {
-            double dx = p0.x - p1.x;
-            double dy = p0.y - p1.y;
-
-            return dx * dx + dy * dy <= distance * distance;
-        }
-    }
-
     void EditorBase::mousePressed(double x, double y) {
         GPoint pt = mViewer->graphicsToWorld(GPoint{x, y});
 
@@ -173,6 +267,10 @@ namespace GraphEditor {
     void EditorBase::dragState(GPoint pt) {
         /* TODO: Collisions with other states? */
         if (hoverNode) {
+            /* Batch the move so that anything else we touch here doesn't pay
+             * for repeated edge recomputation.
+             */
+            ViewerBase::BatchUpdate update(mViewer.get());
             hoverNode->position(hoverNode->position() + (lastState - hoverNode->position()));
             lastState = pt;
             requestRepaint();
@@ -181,7 +279,9 @@ namespace GraphEditor {
     }
 
     void EditorBase::dragTransition(GPoint pt) {
+        mViewer->markDamaged(rectAround(dragEdge0, dragEdge1));
         dragEdge1 = pt;
+        mViewer->markDamaged(rectAround(dragEdge0, dragEdge1));
 
         setHover(mViewer->nodeAt(pt));
         requestRepaint();
@@ -197,9 +297,16 @@ namespace GraphEditor {
 
     void EditorBase::mouseReleased(double x, double y) {
         if (dragType == DragType::EDGE) {
+            /* The in-progress arrow vanishes whether or not an edge results. */
+            mViewer->markDamaged(rectAround(dragEdge0, dragEdge1));
             finishCreatingEdge(mViewer->graphicsToWorld(GPoint{ x, y }));
         }
         dragType = DragType::NONE;
+
+        /* The world may have shifted under the cursor; re-run hit testing on
+         * the next move no matter how small it is.
+         */
+        hasLastHitTest = false;
         requestRepaint();
     }
 
@@ -258,33 +365,54 @@ namespace GraphEditor {
         }
     }
 
-    void EditorBase::drawGraph(GCanvas* canvas,
-                               const std::unordered_map<Node*, NodeStyle>& clientNodeStyles,
-                               const std::unordered_map<Edge*, EdgeStyle>& clientEdgeStyles) {
-        /* Configure styles. */
-        std::unordered_map<Node*, NodeStyle> nodeStyles = clientNodeStyles;
-        std::unordered_map<Edge*, EdgeStyle> edgeStyles = clientEdgeStyles;
+    void EditorBase::rebuildOverlay() {
+        overlayNodeStyles.clear();
+        overlayEdgeStyles.clear();
 
-        /* Active and hover states are NOT mutually exclusive! */
-        if (activeNode && !clientNodeStyles.count(activeNode)) {
-            nodeStyles[activeNode].fillColor = kActiveStateColor;
+        /* Highlights are deltas applied over the entity's retained style.
+         * Active and hover states are NOT mutually exclusive!
+         */
+        if (activeNode) {
+            auto& style = overlayNodeStyles.emplace(activeNode, mViewer->style(activeNode)).first->second;
+            style.fillColor = kActiveStateColor;
         }
-        if (hoverNode && !clientNodeStyles.count(hoverNode)) {
-            nodeStyles[hoverNode].borderColor = kHoverBorderColor;
-            nodeStyles[hoverNode].lineWidth   = kHoverBorderWidth;
-            nodeStyles[hoverNode].radius     -= kHoverBorderWidth / 2.0;
+        if (hoverNode) {
+            auto& style = overlayNodeStyles.emplace(hoverNode, mViewer->style(hoverNode)).first->second;
+            style.borderColor = kHoverBorderColor;
+            style.lineWidth   = kHoverBorderWidth;
+            style.radius     -= kHoverBorderWidth / 2.0;
         }
 
         /* Active transition always takes precedence over hover transition. */
-        if (hoverEdge && !clientEdgeStyles.count(hoverEdge)) {
-            edgeStyles[hoverEdge].lineColor = kHoverTransitionColor;
-            edgeStyles[hoverEdge].lineWidth = GraphEditor::kEdgeTolerance;
+        if (hoverEdge) {
+            auto& style = overlayEdgeStyles.emplace(hoverEdge, mViewer->style(hoverEdge)).first->second;
+            style.lineColor = kHoverTransitionColor;
+            style.lineWidth = GraphEditor::kEdgeTolerance;
+        }
+        if (activeEdge) {
+            auto& style = overlayEdgeStyles.emplace(activeEdge, mViewer->style(activeEdge)).first->second;
+            style.lineColor = kActiveTransitionColor;
+            style.lineWidth = kActiveTransitionWidth;
         }
-        if (activeEdge && !clientEdgeStyles.count(activeEdge)) {
-            edgeStyles[activeEdge].lineColor = kActiveTransitionColor;
-            edgeStyles[activeEdge].lineWidth = kActiveTransitionWidth;
+    }
+
+    void EditorBase::drawGraph(GCanvas* canvas,
+                               const std::unordered_map<Node*, NodeStyle>& clientNodeStyles,
+                               const std::unordered_map<Edge*, EdgeStyle>& clientEdgeStyles) {
+        /* Common case: no per-frame overrides, so the cached overlay maps go
+         * straight through and nothing is built here at all.
+         */
+        if (clientNodeStyles.empty() && clientEdgeStyles.empty()) {
+            mViewer->draw(canvas, overlayNodeStyles, overlayEdgeStyles);
+            return;
         }
 
+        /* Client styles win over the highlight overlay. */
+        std::unordered_map<Node*, NodeStyle> nodeStyles = clientNodeStyles;
+        std::unordered_map<Edge*, EdgeStyle> edgeStyles = clientEdgeStyles;
+        nodeStyles.insert(overlayNodeStyles.begin(), overlayNodeStyles.end());
+        edgeStyles.insert(overlayEdgeStyles.begin(), overlayEdgeStyles.end());
+
         mViewer->draw(canvas, nodeStyles, edgeStyles);
     }
 
@@ -297,16 +425,80 @@ namespace GraphEditor {
     void EditorBase::draw(GCanvas* canvas,
                           const std::unordered_map<Node*, NodeStyle>& nodeStyles,
                           const std::unordered_map<Edge*, EdgeStyle>& edgeStyles) {
+        repaintRequested = false;
         drawGraph(canvas, nodeStyles, edgeStyles);
         drawDraggedEdge(canvas);
+        broadcastPerfSample();
+    }
+
+    void EditorBase::drawDamaged(GCanvas* canvas,
+                                 const std::unordered_map<Node*, NodeStyle>& clientNodeStyles,
+                                 const std::unordered_map<Edge*, EdgeStyle>& clientEdgeStyles) {
+        repaintRequested = false;
+
+        /* Same override policy as drawGraph(); the highlighted entities were
+         * marked damaged when the highlights changed, so the repaint below
+         * picks them up.
+         */
+        if (clientNodeStyles.empty() && clientEdgeStyles.empty()) {
+            mViewer->drawDamaged(canvas, overlayNodeStyles, overlayEdgeStyles);
+        } else {
+            std::unordered_map<Node*, NodeStyle> nodeStyles = clientNodeStyles;
+            std::unordered_map<Edge*, EdgeStyle> edgeStyles = clientEdgeStyles;
+            nodeStyles.insert(overlayNodeStyles.begin(), overlayNodeStyles.end());
+            edgeStyles.insert(overlayEdgeStyles.begin(), overlayEdgeStyles.end());
+
+            mViewer->drawDamaged(canvas, nodeStyles, edgeStyles);
+        }
+        drawDraggedEdge(canvas);
+        broadcastPerfSample();
+    }
+
+    bool EditorBase::instrumentationEnabled() const {
+        return mViewer->instrumentationEnabled();
+    }
+
+    void EditorBase::instrumentationEnabled(bool enabled) {
+        mViewer->instrumentationEnabled(enabled);
+    }
+
+    const PerfStats& EditorBase::perfStats() const {
+        return mViewer->perfStats();
+    }
+
+    void EditorBase::resetPerfStats() {
+        mViewer->resetPerfStats();
+    }
+
+    void EditorBase::broadcastPerfSample() {
+        if (!mViewer->instrumentationEnabled()) return;
+
+        for (auto listener: mListeners) {
+            listener->perfSample(mViewer->perfStats());
+        }
     }
 
     void EditorBase::requestRepaint() {
+        /* Collapse bursts of requests: listeners hear about the first one,
+         * and the next draw re-arms us. A fast mouse sweep then costs one
+         * repaint per frame instead of one per event.
+         */
+        if (repaintRequested) return;
+        repaintRequested = true;
+
         for (auto listener: mListeners) {
             listener->needsRepaint();
         }
     }
 
+    double EditorBase::hoverEpsilon() const {
+        return mHoverEpsilon;
+    }
+
+    void EditorBase::hoverEpsilon(double epsilon) {
+        mHoverEpsilon = epsilon;
+    }
+
     void EditorBase::addListener(std::shared_ptr<Listener> listener) {
         mListeners.push_back(listener);
     }
@@ -339,4 +531,16 @@ namespace GraphEditor {
     void Listener::entityCreated(Entity *) {
         // Do nothing
     }
+
+    void Listener::perfSample(const PerfStats &) {
+        // Do nothing
+    }
+
+    void Listener::saveCompleted(bool) {
+        // Do nothing
+    }
+
+    bool Listener::importProgress(std::size_t) {
+        return true;
+    }
 }
@@ -1,8 +1,15 @@
 #pragma once
 
 #include "GraphViewer.h"
+#include <thread>
 
 namespace GraphEditor {
+    /* On-disk formats saveAsync() can produce. */
+    enum class FileFormat {
+        BINARY, // toBinary()'s format: compact, fast to reload.
+        JSON    // The interchange format, as written by serialize().
+    };
+
     /* Listener interface. */
     class Listener {
     public:
@@ -13,6 +20,25 @@ namespace GraphEditor {
         virtual void entitySelected(Entity* entity);
         virtual void entityHovered(Entity* entity);
         virtual void entityCreated(Entity* entity);
+
+        /* Fired after each draw while instrumentation is enabled on the
+         * editor, carrying that frame's counters. Intended for live perf
+         * displays.
+         */
+        virtual void perfSample(const PerfStats& stats);
+
+        /* Fired when a saveAsync() write finishes. Unlike every other
+         * callback, this one runs on the background thread that performed
+         * the write; implementations that touch UI state must forward to
+         * their own event loop.
+         */
+        virtual void saveCompleted(bool succeeded);
+
+        /* Fired periodically during importEdgeList() with the number of
+         * edges read so far. Return false to cancel the import; the default
+         * returns true.
+         */
+        virtual bool importProgress(std::size_t edgesRead);
     };
 
     /* Base type for all editors. You should not use this type directly; it's for
@@ -20,7 +46,7 @@ namespace GraphEditor {
      */
     class EditorBase {
     public:
-        virtual ~EditorBase() = default;
+        virtual ~EditorBase();
     
         /* Handles these mouse events to support dragging, adding new lines,
          * etc. Forward these messages to have the editor handle dragging,
@@ -47,9 +73,46 @@ namespace GraphEditor {
                   const std::unordered_map<Node*, NodeStyle>& nodeStyles = {},
                   const std::unordered_map<Edge*, EdgeStyle>& edgeStyles = {});
 
+        /* As draw(), but only repaints the parts of the canvas the viewer has
+         * flagged as damaged since the last paint. The highlight changes this
+         * editor makes (selection, hover) are tracked as damage too, so a
+         * client whose canvas persists between frames can call this from its
+         * repaint handler instead of draw().
+         */
+        void drawDamaged(GCanvas* canvas,
+                         const std::unordered_map<Node*, NodeStyle>& nodeStyles = {},
+                         const std::unordered_map<Edge*, EdgeStyle>& edgeStyles = {});
+
         /* Sets which entity is active, if any. */
         void setActive(GraphEditor::Entity* active);
 
+        /* Opt-in instrumentation, forwarded to the underlying viewer. While
+         * enabled, listeners receive a perfSample() after each draw.
+         */
+        bool instrumentationEnabled() const;
+        void instrumentationEnabled(bool enabled);
+        const PerfStats& perfStats() const;
+        void resetPerfStats();
+
+        /* World-space distance the cursor must travel before mouseMoved()
+         * re-runs hit testing. Raw mouse events arrive far faster than
+         * anything on screen can change; jitter below this threshold is
+         * ignored.
+         */
+        double hoverEpsilon() const;
+        void hoverEpsilon(double epsilon);
+
+        /* Saves the graph to the given file without blocking interaction:
+         * the graph is snapshotted on the calling thread (one cheap record
+         * copy), then serialized and written on a background thread.
+         * Listeners receive saveCompleted() once the write finishes.
+         *
+         * At most one save is in flight at a time; a new request first waits
+         * out any write still running, which at autosave cadence has long
+         * since finished.
+         */
+        void saveAsync(const std::string& filename, FileFormat format = FileFormat::BINARY);
+
     private:
         EditorBase(std::shared_ptr<ViewerBase>);
         std::shared_ptr<ViewerBase> mViewer;
@@ -62,9 +125,33 @@ namespace GraphEditor {
         Edge* activeEdge = nullptr;
         Edge* hoverEdge  = nullptr;
 
+        /* Highlight styles for the active/hovered items, rebuilt whenever the
+         * selection or hover changes rather than on every draw. Empty unless
+         * something is highlighted.
+         */
+        std::unordered_map<Node*, NodeStyle> overlayNodeStyles;
+        std::unordered_map<Edge*, EdgeStyle> overlayEdgeStyles;
+        void rebuildOverlay();
+
         /* For dragging things. */
         GPoint lastState;
 
+        /* Repaint coalescing: once a repaint has been requested, further
+         * requests are dropped until the next draw re-arms us, so listeners
+         * see at most one needsRepaint() per frame.
+         */
+        bool repaintRequested = false;
+
+        /* Hover throttling state: where the cursor was the last time we ran
+         * hit testing, if anywhere.
+         */
+        GPoint lastHitTest;
+        bool hasLastHitTest = false;
+        double mHoverEpsilon = 2.0 / 1000; // 2px on a 1000px window
+
+        /* Background writer for saveAsync(), joined on destruction. */
+        std::thread saveWorker;
+
         /* For dragging edges. */
         GPoint dragEdge0, dragEdge1;
         Node* edgeStart = nullptr;
@@ -103,6 +190,9 @@ namespace GraphEditor {
         void dirty();
         void requestRepaint();
 
+        /* Delivers a perfSample() to listeners if instrumentation is on. */
+        void broadcastPerfSample();
+
         /* Firewalled off from the base. We promise the types will work. */
         virtual Node* newNode(const GPoint& pt) = 0;
         virtual Edge* newEdge(Node* from, Node* to) = 0;
@@ -131,6 +221,12 @@ namespace GraphEditor {
         void deleteNode(NodeType* node);
         void deleteEdge(EdgeType* edge);
 
+        /* Imports an edge list through the viewer (see
+         * Viewer::importEdgeList), reporting progress to the listeners; any
+         * listener returning false from importProgress() cancels the import.
+         */
+        std::size_t importEdgeList(std::istream& in);
+
         /* Retrieve the underlying editor. */
         std::shared_ptr<Viewer> viewer();
 
@@ -169,6 +265,21 @@ namespace GraphEditor {
         dirty();
     }
 
+    template <typename Viewer>
+    std::size_t Editor<Viewer>::importEdgeList(std::istream& in) {
+        auto result = mViewer->importEdgeList(in, [this](std::size_t edgesRead) {
+            bool keepGoing = true;
+            for (auto listener: mListeners) {
+                if (!listener->importProgress(edgesRead)) keepGoing = false;
+            }
+            return keepGoing;
+        });
+
+        dirty();
+        requestRepaint();
+        return result;
+    }
+
     template <typename Viewer>
     void Editor<Viewer>::deleteEdge(EdgeType* edge) {
         /* Remove from the list of transitions. */
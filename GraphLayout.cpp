@@ -0,0 +1,333 @@
+#include "GraphLayout.h"
+#include "GVector.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+
+namespace GraphEditor {
+    namespace {
+        /* Barnes-Hut opening criterion: a cell whose size-to-distance ratio
+         * is below this is summarized by its centroid instead of descended
+         * into. Larger is faster and less accurate; 0.7 is a common middle
+         * ground.
+         */
+        const double kTheta = 0.7;
+
+        /* Leaves hold up to this many points before splitting. */
+        const std::size_t kLeafCapacity = 8;
+
+        /* Fraction of world width the initial temperature allows per move. */
+        const double kInitialTemperature = 0.1;
+
+        /* Nodes stay at least this far inside the world rectangle. */
+        const double kLayoutMargin = 0.05;
+
+        /* Below this many nodes the repulsion pass runs on one thread. */
+        const std::size_t kLayoutGrain = 2048;
+
+        /* Quadtree over a fixed set of points, built once per iteration.
+         * Cells are laid out in one flat pool; leaves own contiguous runs of
+         * a shared index array, so building is just recursive partitioning
+         * with no per-point allocation.
+         */
+        class QuadTree {
+        public:
+            QuadTree(const std::vector<double>& xs, const std::vector<double>& ys)
+                : xs(xs), ys(ys) {
+                order.resize(xs.size());
+                for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+
+                /* Square region covering every point. */
+                double minX = 0, minY = 0, maxX = 1, maxY = 1;
+                if (!xs.empty()) {
+                    minX = *std::min_element(xs.begin(), xs.end());
+                    maxX = *std::max_element(xs.begin(), xs.end());
+                    minY = *std::min_element(ys.begin(), ys.end());
+                    maxY = *std::max_element(ys.begin(), ys.end());
+                }
+                double size = std::max({ maxX - minX, maxY - minY, 1e-9 });
+
+                build(0, order.size(), minX, minY, size);
+            }
+
+            /* Accumulates the net repulsive displacement felt by point i,
+             * with per-point magnitude k^2 / distance (Fruchterman-Reingold),
+             * into (outX, outY).
+             */
+            void repulsionAt(std::size_t i, double k2, double& outX, double& outY) const {
+                if (!cells.empty()) accumulate(0, i, k2, outX, outY);
+            }
+
+        private:
+            struct Cell {
+                double x0, y0, size;       // Region covered (a square).
+                double sumX = 0, sumY = 0; // Sum of member positions.
+                std::size_t count = 0;
+                int child[4] = { -1, -1, -1, -1 };
+                std::size_t pointsBegin = 0, pointsEnd = 0; // Leaf contents.
+            };
+
+            const std::vector<double>& xs;
+            const std::vector<double>& ys;
+            std::vector<std::size_t> order; // Point indices, leaf runs contiguous.
+            std::vector<Cell> cells;        // Pool; cell 0 is the root.
+
+            int build(std::size_t begin, std::size_t end,
+                      double x0, double y0, double size) {
+                int index = int(cells.size());
+                cells.push_back({});
+
+                /* Fill in a local copy and assign at the end; recursion below
+                 * may grow the pool and invalidate references into it.
+                 */
+                Cell cell;
+                cell.x0 = x0; cell.y0 = y0; cell.size = size;
+                cell.count = end - begin;
+                for (std::size_t i = begin; i < end; i++) {
+                    cell.sumX += xs[order[i]];
+                    cell.sumY += ys[order[i]];
+                }
+
+                if (cell.count <= kLeafCapacity) {
+                    cell.pointsBegin = begin;
+                    cell.pointsEnd   = end;
+                } else {
+                    double midX = x0 + size / 2, midY = y0 + size / 2;
+                    auto* base = order.data();
+
+                    /* Partition the run into quadrants: first by x, then each
+                     * half by y.
+                     */
+                    auto* xSplit = std::partition(base + begin, base + end,
+                        [&](std::size_t p) { return xs[p] < midX; });
+                    auto* ySplitLeft = std::partition(base + begin, xSplit,
+                        [&](std::size_t p) { return ys[p] < midY; });
+                    auto* ySplitRight = std::partition(xSplit, base + end,
+                        [&](std::size_t p) { return ys[p] < midY; });
+
+                    std::size_t bounds[5] = {
+                        begin,
+                        std::size_t(ySplitLeft - base),
+                        std::size_t(xSplit - base),
+                        std::size_t(ySplitRight - base),
+                        end
+                    };
+                    double childX[4] = { x0, x0, midX, midX };
+                    double childY[4] = { y0, midY, y0, midY };
+                    for (int q = 0; q < 4; q++) {
+                        if (bounds[q] == bounds[q + 1]) continue;
+                        cell.child[q] = build(bounds[q], bounds[q + 1],
+                                              childX[q], childY[q], size / 2);
+                    }
+                }
+
+                cells[index] = cell;
+                return index;
+            }
+
+            void accumulate(int c, std::size_t i, double k2,
+                            double& outX, double& outY) const {
+                const Cell& cell = cells[c];
+                if (cell.count == 0) return;
+
+                double px = xs[i], py = ys[i];
+                double dx = px - cell.sumX / cell.count;
+                double dy = py - cell.sumY / cell.count;
+                double d2 = dx * dx + dy * dy;
+
+                /* Far enough away? Treat the whole cell as one point mass. */
+                if (cell.size * cell.size < kTheta * kTheta * d2) {
+                    double scale = cell.count * k2 / std::max(d2, 1e-12);
+                    outX += dx * scale;
+                    outY += dy * scale;
+                    return;
+                }
+
+                if (cell.child[0] < 0 && cell.child[1] < 0 &&
+                    cell.child[2] < 0 && cell.child[3] < 0) {
+                    /* Leaf: exact pairwise terms, skipping the point itself. */
+                    for (std::size_t p = cell.pointsBegin; p < cell.pointsEnd; p++) {
+                        std::size_t j = order[p];
+                        if (j == i) continue;
+
+                        double ex = px - xs[j], ey = py - ys[j];
+                        double e2 = std::max(ex * ex + ey * ey, 1e-12);
+                        outX += ex * k2 / e2;
+                        outY += ey * k2 / e2;
+                    }
+                } else {
+                    for (int q = 0; q < 4; q++) {
+                        if (cell.child[q] >= 0) accumulate(cell.child[q], i, k2, outX, outY);
+                    }
+                }
+            }
+        };
+
+        /* Splits [0, count) into contiguous slices, one per worker, and runs
+         * callback(begin, end) on each; small inputs stay on this thread.
+         */
+        template <typename Callback>
+        void forEachSlice(std::size_t count, unsigned threadCount, Callback callback) {
+            if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+            if (threadCount == 0) threadCount = 1;
+
+            std::size_t slices = std::min<std::size_t>(threadCount, count / kLayoutGrain);
+            if (slices <= 1) {
+                callback(std::size_t(0), count);
+                return;
+            }
+
+            std::vector<std::thread> workers;
+            workers.reserve(slices);
+            for (std::size_t s = 0; s < slices; s++) {
+                std::size_t begin = count *  s      / slices;
+                std::size_t end   = count * (s + 1) / slices;
+                workers.emplace_back([callback, begin, end] { callback(begin, end); });
+            }
+            for (auto& worker: workers) worker.join();
+        }
+    }
+
+    LayoutEngine::LayoutEngine(std::shared_ptr<ViewerBase> viewer): mViewer(viewer) {
+        // Handled above
+    }
+
+    void LayoutEngine::start(std::size_t iterations) {
+        remaining   = iterations;
+        total       = iterations;
+        temperature = kInitialTemperature;
+    }
+
+    bool LayoutEngine::step(std::size_t iterations) {
+        if (remaining == 0) return false;
+
+        ViewerBase* viewer = mViewer.get();
+        double worldHeight = 1 / viewer->aspectRatio();
+
+        /* Flatten the graph: positions structure-of-arrays, edges as index
+         * pairs. Re-read every call so that edits between calls are honored.
+         */
+        std::vector<Node*> layoutNodes = viewer->nodeList;
+        std::size_t n = layoutNodes.size();
+        if (n == 0) {
+            remaining = 0;
+            return false;
+        }
+
+        std::vector<double> xs(n), ys(n);
+        std::unordered_map<Node*, std::size_t> indexOf;
+        indexOf.reserve(n);
+        for (std::size_t i = 0; i < n; i++) {
+            xs[i] = layoutNodes[i]->position().x;
+            ys[i] = layoutNodes[i]->position().y;
+            indexOf[layoutNodes[i]] = i;
+        }
+
+        std::vector<std::pair<std::size_t, std::size_t>> springs;
+        springs.reserve(viewer->edgeList.size());
+        viewer->visitEdges([&](Edge* edge) {
+            /* Self-loops exert no net force. */
+            if (edge->from() != edge->to()) {
+                springs.push_back({ indexOf[edge->from()], indexOf[edge->to()] });
+            }
+        });
+
+        /* Ideal pairwise distance: nodes evenly sharing the world's area. */
+        double k  = std::sqrt(worldHeight / n);
+        double k2 = k * k;
+
+        std::vector<double> dispX(n), dispY(n);
+        std::vector<double> mag2(n), normX(n), normY(n);
+        for (std::size_t iter = 0; iter < iterations && remaining > 0; iter++, remaining--) {
+            QuadTree tree(xs, ys);
+
+            /* Repulsion: each point reads the shared tree and writes only its
+             * own slot, so slices are independent and the reduction order -
+             * hence the result - never depends on the thread count.
+             */
+            forEachSlice(n, mThreads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    dispX[i] = dispY[i] = 0;
+                    tree.repulsionAt(i, k2, dispX[i], dispY[i]);
+                }
+            });
+
+            /* Attraction along edges, magnitude d^2 / k. */
+            for (const auto& spring: springs) {
+                double dx = xs[spring.first] - xs[spring.second];
+                double dy = ys[spring.first] - ys[spring.second];
+                double d  = std::sqrt(dx * dx + dy * dy);
+                if (d < 1e-12) continue;
+
+                double pull = d / k; // (d^2 / k) applied to the unit vector.
+                dispX[spring.first]  -= dx * pull;
+                dispY[spring.first]  -= dy * pull;
+                dispX[spring.second] += dx * pull;
+                dispY[spring.second] += dy * pull;
+            }
+
+            /* Move, but no farther than the temperature, and never off the
+             * edge of the world; then cool toward zero over the run. The
+             * magnitudes and directions come from the batched GVector
+             * kernels, which sweep the contiguous displacement arrays in
+             * autovectorizable passes.
+             */
+            GVectorSpan disp{ dispX.data(), dispY.data(), n };
+            batchDot(disp, disp, mag2.data());
+            batchNormalize(disp, normX.data(), normY.data());
+
+            for (std::size_t i = 0; i < n; i++) {
+                double d = std::sqrt(mag2[i]);
+                if (d < 1e-12) continue;
+
+                double allowed = std::min(d, temperature);
+                xs[i] += normX[i] * allowed;
+                ys[i] += normY[i] * allowed;
+
+                xs[i] = std::min(std::max(xs[i], kLayoutMargin), 1 - kLayoutMargin);
+                ys[i] = std::min(std::max(ys[i], kLayoutMargin),
+                                 worldHeight - kLayoutMargin);
+            }
+            temperature = kInitialTemperature * remaining / std::max<std::size_t>(total, 1);
+        }
+
+        /* Land the new positions in one batch. Every node moved, so flag a
+         * full geometry rebuild rather than letting the incremental path
+         * churn through a moved set covering the whole graph.
+         */
+        {
+            ViewerBase::BatchUpdate update(viewer);
+            viewer->edgeEndpointsDirty = true; // Before the moves, so none is tracked.
+            for (std::size_t i = 0; i < n; i++) {
+                layoutNodes[i]->position({ xs[i], ys[i] });
+            }
+        }
+
+        for (auto listener: mListeners) {
+            listener->needsRepaint();
+        }
+        return remaining > 0;
+    }
+
+    void LayoutEngine::run(std::size_t iterations) {
+        start(iterations);
+        step(iterations);
+    }
+
+    std::size_t LayoutEngine::iterationsRemaining() const {
+        return remaining;
+    }
+
+    unsigned LayoutEngine::threads() const {
+        return mThreads;
+    }
+
+    void LayoutEngine::threads(unsigned threads) {
+        mThreads = threads;
+    }
+
+    void LayoutEngine::addListener(std::shared_ptr<Listener> listener) {
+        mListeners.push_back(listener);
+    }
+}
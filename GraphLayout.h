@@ -0,0 +1,75 @@
+#pragma once
+
+#include "GraphEditor.h"
+#include <memory>
+#include <vector>
+
+namespace GraphEditor {
+    /* How many iterations a layout run performs unless told otherwise. */
+    const std::size_t kDefaultLayoutIterations = 300;
+
+    /* Force-directed auto-layout over a viewer's graph, in the style of
+     * Fruchterman-Reingold: connected nodes attract, all nodes repel, and a
+     * falling temperature caps how far anything moves each iteration. The
+     * repulsion term is approximated with a Barnes-Hut quadtree and spread
+     * across worker threads, so a pass stays tractable on graphs with
+     * hundreds of thousands of nodes.
+     *
+     * The engine runs incrementally: start() arms a run, and each step()
+     * advances it by a few iterations and applies the new positions through
+     * one batch update, so intermediate results appear on screen as the
+     * layout converges. Attach a Listener to be told (via needsRepaint())
+     * whenever a step lands. Typical use, from an idle or timer hook:
+     *
+     *     engine.start();
+     *     ... each tick: if (!engine.step(5)) stopTicking();
+     *
+     * The graph must not be mutated during a step() call, but may change
+     * freely between calls; each step re-reads the graph from scratch.
+     */
+    class LayoutEngine {
+    public:
+        explicit LayoutEngine(std::shared_ptr<ViewerBase> viewer);
+
+        /* Arms a run of the given number of iterations, resetting the
+         * temperature. Any iterations left from a previous run are dropped.
+         */
+        void start(std::size_t iterations = kDefaultLayoutIterations);
+
+        /* Advances the current run by up to the given number of iterations,
+         * then applies the resulting positions. Returns true if iterations
+         * remain, false once the run is finished (or none was started).
+         */
+        bool step(std::size_t iterations = 1);
+
+        /* Convenience: a whole run in one call. */
+        void run(std::size_t iterations = kDefaultLayoutIterations);
+
+        std::size_t iterationsRemaining() const;
+
+        /* Worker threads for the repulsion pass. Zero (the default) sizes to
+         * the hardware; one forces serial. Same contract as
+         * ViewerBase::endpointThreads(): the result doesn't depend on it.
+         */
+        unsigned threads() const;
+        void threads(unsigned threads);
+
+        /* Callback registration; listeners get needsRepaint() after each
+         * step() that moved anything.
+         */
+        void addListener(std::shared_ptr<Listener> listener);
+
+    private:
+        std::shared_ptr<ViewerBase> mViewer;
+        std::vector<std::shared_ptr<Listener>> mListeners;
+
+        unsigned mThreads = 0;
+
+        /* Run state: iterations left, total armed, and the current
+         * temperature (maximum world-space displacement per iteration).
+         */
+        std::size_t remaining = 0;
+        std::size_t total     = 0;
+        double temperature    = 0;
+    };
+}
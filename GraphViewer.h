@@ -7,14 +7,27 @@
 
 #include "gobjects.h"
 #include "gwindow.h"
+#include "GVector.h"
 #include "../GUI/Font.h"
 #include "Utilities/JSON.h"
 #include <string>
 #include <set>
 #include <unordered_map>
+#include <vector>
 #include <memory>
 #include <functional>
+#include <type_traits>
 #include <istream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+
+namespace MiniGUI {
+    class TextRender;
+}
 
 namespace GraphEditor {
     class ViewerBase;
@@ -45,6 +58,18 @@ namespace GraphEditor {
      */
     const double kEdgeTolerance = 16.0 / 1000;
 
+    /* On-screen node radius, in pixels, below which OVERVIEW rendering stops
+     * drawing labels, borders, and arrowheads. At that size they're subpixel
+     * noise anyway.
+     */
+    const double kDefaultSimplificationThreshold = 6;
+
+    /* How many undo checkpoints a viewer retains by default. */
+    const std::size_t kDefaultCheckpointLimit = 64;
+
+    /* How many edges importEdgeList() reads between progress callbacks. */
+    const std::size_t kImportProgressInterval = 10000;
+
     const MiniGUI::Font kEdgeFont(MiniGUI::FontFamily::UNICODE_MONOSPACE, MiniGUI::FontStyle::NORMAL, 18, MiniGUI::Color::BLACK());
     const MiniGUI::Font kNodeFont(MiniGUI::FontFamily::UNICODE_SERIF,     MiniGUI::FontStyle::ITALIC, 18, MiniGUI::Color::BLACK());
 
@@ -70,6 +95,77 @@ namespace GraphEditor {
         MiniGUI::Color labelColor = kEdgeColor;
     };
 
+    /* Pool of recycled entity indices. Semantically a set of free IDs from
+     * which allocation always hands out the smallest, but stored as a bitmap
+     * with a cached lowest-free hint: one bit per ID ever seen rather than a
+     * tree node per free ID, and no allocations on the alloc/release path.
+     */
+    class IndexPool {
+    public:
+        bool empty() const {
+            return freeCount == 0;
+        }
+
+        /* Removes and returns the smallest free index. Only call this when
+         * the pool isn't empty.
+         */
+        std::size_t allocate() {
+            for (std::size_t word = lowestHint / 64; word < bits.size(); word++) {
+                if (bits[word] == 0) continue;
+
+                std::size_t bit = 0;
+                while (!(bits[word] & (1ULL << bit))) bit++;
+
+                bits[word] &= ~(1ULL << bit);
+                freeCount--;
+
+                /* Nothing below this index is free; remember that. */
+                std::size_t index = word * 64 + bit;
+                lowestHint = index;
+                return index;
+            }
+            return 0; // Unreachable if the pool is nonempty.
+        }
+
+        /* Marks the given index free. */
+        void release(std::size_t index) {
+            std::size_t word = index / 64;
+            if (word >= bits.size()) bits.resize(word + 1, 0);
+
+            unsigned long long mask = 1ULL << (index % 64);
+            if (bits[word] & mask) return; // Already free.
+
+            bits[word] |= mask;
+            freeCount++;
+            if (index < lowestHint) lowestHint = index;
+        }
+
+        /* Rebuilds the pool in one pass: every index in [0, universe) not
+         * present in the (sorted, duplicate-free) used list becomes free.
+         * This is how the bulk loaders recover the free IDs.
+         */
+        void setUniverse(std::size_t universe, const std::vector<std::size_t>& sortedUsed) {
+            bits.assign((universe + 63) / 64, 0);
+            freeCount  = 0;
+            lowestHint = 0;
+
+            std::size_t next = 0;
+            for (std::size_t i = 0; i < universe; i++) {
+                if (next < sortedUsed.size() && sortedUsed[next] == i) {
+                    next++;
+                } else {
+                    bits[i / 64] |= 1ULL << (i % 64);
+                    freeCount++;
+                }
+            }
+        }
+
+    private:
+        std::vector<unsigned long long> bits; // 1 = free
+        std::size_t freeCount  = 0;
+        std::size_t lowestHint = 0;
+    };
+
     /* Base type for graph entities. */
     class Entity {
     public:
@@ -126,6 +222,29 @@ namespace GraphEditor {
 
         std::string mLabel;
 
+        /* Where we sit in the viewer's flat node array. */
+        std::size_t mSlot = 0;
+
+        /* Cached label render, plus the inputs it was built from. Labels
+         * rarely change between frames, so steady-state redraws reuse the
+         * laid-out text rather than re-shaping it.
+         */
+        std::shared_ptr<MiniGUI::TextRender> cachedLabelRender;
+        GRectangle cachedLabelBounds{0, 0, 0, 0};
+        std::string cachedLabelText;
+        int cachedLabelColor = 0;
+
+        /* Retained disk render: the oval persists across frames and is only
+         * restyled when its on-screen bounds or colors change, so redrawing
+         * an unmoved node constructs nothing. The initial bounds are
+         * deliberately unmatchable.
+         */
+        GOval cachedDisk;
+        GRectangle cachedDiskBounds{0, 0, -1, -1};
+        int cachedDiskFill = 0;
+        int cachedDiskBorder = 0;
+        double cachedDiskLineWidth = -1;
+
         friend class ViewerBase;
         template <typename N, typename T> friend class Viewer;
     };
@@ -170,6 +289,9 @@ namespace GraphEditor {
         /* Style of transition used. */
         std::shared_ptr<struct EdgeRender> style;
 
+        /* Where we sit in the viewer's flat edge array. */
+        std::size_t mSlot = 0;
+
         friend class ViewerBase;
         template <typename N, typename T> friend class Viewer;
     };
@@ -180,6 +302,48 @@ namespace GraphEditor {
         UNDIRECTED
     };
 
+    /* Rendering modes. DETAILED draws every entity in full, as always.
+     * OVERVIEW is meant for very large graphs: entities whose bounds fall
+     * outside the visible region are skipped outright, and once nodes shrink
+     * below the simplification threshold on screen, nodes collapse to plain
+     * filled disks and edges to plain lines, with labels and arrowheads
+     * dropped entirely.
+     */
+    enum class RenderMode {
+        DETAILED,
+        OVERVIEW
+    };
+
+    /* Performance counters, maintained while instrumentation is enabled (see
+     * ViewerBase::instrumentationEnabled). The per-frame fields are reset at
+     * the start of each draw; the cumulative fields run until explicitly
+     * reset. All times are wall-clock milliseconds.
+     */
+    struct PerfStats {
+        /* Per-frame phase timings from the most recent draw. Text layout
+         * happens inside the edge and node passes, so its time is also
+         * included in theirs.
+         */
+        double edgeDrawMs   = 0;
+        double nodeDrawMs   = 0;
+        double textLayoutMs = 0;
+
+        /* Cumulative invocation counts and time. Endpoint computations count
+         * both full and incremental passes.
+         */
+        std::size_t endpointComputations  = 0;
+        double      endpointComputationMs = 0;
+        std::size_t nodeQueries = 0;
+        double      nodeQueryMs = 0;
+        std::size_t edgeQueries = 0;
+        double      edgeQueryMs = 0;
+
+        /* How many edge renders have been allocated; in steady state (e.g.
+         * during a drag) this growing quickly means render churn.
+         */
+        std::size_t edgeRendersAllocated = 0;
+    };
+
     /* Base type containing the logic to draw a graph. You will likely not
      * need to make use of this type directly; instead, use the parameterized
      * Viewer type.
@@ -192,9 +356,103 @@ namespace GraphEditor {
         double aspectRatio();
         void aspectRatio(double ratio);
 
+        /* Batch mutation support. Each structural change to the graph (adding or
+         * moving a node, adding or removing an edge, etc.) normally recomputes the
+         * endpoints of every edge, which gets expensive quickly when making many
+         * changes at once. Bracketing a series of changes with beginUpdate() and
+         * endUpdate() defers that recomputation until the outermost endUpdate(),
+         * where it runs exactly once.
+         *
+         * Calls nest; only the outermost endUpdate() triggers the recomputation.
+         */
+        void beginUpdate();
+        void endUpdate();
+
+        /* RAII helper that opens a batch update in its constructor and closes it
+         * in its destructor. Prefer this to calling beginUpdate() / endUpdate()
+         * manually; it's exception-safe.
+         */
+        class BatchUpdate {
+        public:
+            explicit BatchUpdate(ViewerBase* viewer): mViewer(viewer) {
+                mViewer->beginUpdate();
+            }
+            ~BatchUpdate() {
+                mViewer->endUpdate();
+            }
+
+            BatchUpdate(const BatchUpdate&) = delete;
+            BatchUpdate& operator=(const BatchUpdate&) = delete;
+
+        private:
+            ViewerBase* mViewer;
+        };
+
         /* Serializes the viewer to a JSON object. */
         JSON toJSON();
 
+        /* Serializes the viewer to a compact, versioned binary format:
+         * fixed-width little-endian records plus a string table, written in a
+         * single sequential pass. Loading it back skips JSON parsing entirely,
+         * which matters for graphs whose JSON form runs to tens of megabytes.
+         * JSON remains the interchange format; treat the binary form as a
+         * fast local cache.
+         */
+        void toBinary(std::ostream& out);
+
+        /* Serializes the viewer as JSON text written directly to the stream.
+         * Produces the same format as toJSON(), but streams it out in one
+         * pass without ever materializing the DOM, so saving runs in O(1)
+         * auxiliary memory no matter how large the graph is.
+         */
+        void serialize(std::ostream& out);
+
+        /* Reports whether the stream holds binary graph data, by checking
+         * (without consuming) the magic bytes at the current position.
+         */
+        static bool isBinaryFormat(std::istream& in);
+
+    private:
+        struct GraphData; // Defined below, with the rest of the record types.
+
+    public:
+        /* Immutable copy of the graph as plain records, sharing no state with
+         * the live graph: once captured, it can be written out from any
+         * thread while editing continues. Capturing one is a single O(V + E)
+         * pass; copying a captured snapshot is free.
+         */
+        class Snapshot {
+        public:
+            /* Write the snapshot in the binary format or the JSON interchange
+             * format; output matches toBinary() / serialize() as of the
+             * capture.
+             */
+            void writeBinary(std::ostream& out) const;
+            void writeJSON(std::ostream& out) const;
+
+        private:
+            explicit Snapshot(std::shared_ptr<const GraphData> data): mData(data) {}
+            std::shared_ptr<const GraphData> mData;
+
+            friend class ViewerBase;
+            template <typename N, typename T> friend class Viewer;
+        };
+
+        /* Captures a snapshot of the graph as it stands. */
+        Snapshot snapshot();
+
+        /* Undo checkpoints: checkpoint() pushes a snapshot onto a bounded
+         * history, dropping the oldest entry past the limit, and
+         * Viewer::undo() restores and pops the most recent one. Taking a
+         * checkpoint is one O(V + E) record copy - cheap enough for one per
+         * edit - and each costs a fraction of the live graph's footprint,
+         * since it holds plain records rather than nodes, edges, and indexes.
+         */
+        void checkpoint();
+        std::size_t numCheckpoints() const;
+        std::size_t checkpointLimit() const;
+        void checkpointLimit(std::size_t limit);
+
         /* Sets the bounding box where the viewer should draw the graph.
          * Default is the empty rectangle.
          */
@@ -202,11 +460,83 @@ namespace GraphEditor {
 
         /* Default graphics parameters will be used everywhere, except for the
          * explicit states and transitions that override it.
+         *
+         * The canvas may be null, in which case all of the layout and caching
+         * work runs but nothing is submitted for rendering. The benchmark
+         * harness uses this to time the draw path headlessly.
+         *
+         * Rendering is retained: entities keep persistent graphics objects
+         * that are restyled only when the underlying inputs change, and a
+         * repeat call for a scene the canvas already shows (no damage
+         * recorded, no style overrides either time) returns without issuing
+         * anything at all.
          */
         void draw(GCanvas* canvas,
                   const std::unordered_map<Node*, NodeStyle>& nodeStyles = {},
                   const std::unordered_map<Edge*, EdgeStyle>& edgeStyles = {});
 
+        /* Damage tracking. The viewer records which entities changed since the
+         * last full draw (moved nodes, rebuilt edge renders, restyled
+         * hover/selection targets). Clients that want cheap repaints can ask
+         * for the damaged region and use drawDamaged(), which re-renders only
+         * the entities overlapping that region; bounds or zoom changes degrade
+         * to a full redraw. draw() always repaints everything and resets the
+         * damage state.
+         */
+        bool hasDamage() const;
+
+        /* Damaged region, in graphics coordinates. Meaningless if there is no
+         * damage or if the damage covers everything; check hasDamage() and
+         * hasFullDamage() first.
+         */
+        GRectangle damagedRegion();
+        bool hasFullDamage() const;
+
+        /* Repaints just the damaged region: clears it to the background color,
+         * then redraws the entities that overlap it. Falls back to a full
+         * draw() when everything is damaged.
+         */
+        void drawDamaged(GCanvas* canvas,
+                         const std::unordered_map<Node*, NodeStyle>& nodeStyles = {},
+                         const std::unordered_map<Edge*, EdgeStyle>& edgeStyles = {});
+
+        /* Opt-in instrumentation; see PerfStats above. Disabled by default,
+         * in which state the hot paths pay only an untaken branch.
+         */
+        bool instrumentationEnabled() const;
+        void instrumentationEnabled(bool enabled);
+
+        const PerfStats& perfStats() const;
+        void resetPerfStats();
+
+        /* Retained per-entity styles, stored in slot arrays parallel to the
+         * flat entity lists so the draw loops read them with one indexed
+         * load. The setters record damage; reads during drawing are free of
+         * hash lookups. Styles passed to draw() override these for a frame.
+         */
+        const NodeStyle& style(Node* node) const;
+        void style(Node* node, const NodeStyle& style);
+        const EdgeStyle& style(Edge* edge) const;
+        void style(Edge* edge, const EdgeStyle& style);
+
+        /* Rendering mode; see RenderMode above. Default is DETAILED. */
+        RenderMode renderMode() const;
+        void renderMode(RenderMode mode);
+
+        /* On-screen node radius, in pixels, below which OVERVIEW mode draws
+         * simplified entities. Has no effect in DETAILED mode.
+         */
+        double simplificationThreshold() const;
+        void simplificationThreshold(double pixels);
+
+        /* Worker threads used when edge geometry is recomputed from scratch.
+         * Zero (the default) sizes the pool to the hardware; one forces the
+         * serial path. Graphs too small to be worth the thread launches run
+         * serially regardless, and the result never depends on the setting.
+         */
+        unsigned endpointThreads() const;
+        void endpointThreads(unsigned threads);
+
         /* Rectangle we were instructed to fill. */
         GRectangle bounds() const;
 
@@ -230,6 +560,25 @@ namespace GraphEditor {
         Type type() const;
         void type(Type type);
 
+        /* Viewport. The zoom factor magnifies the world about the pan point,
+         * which is the world-space point drawn at the top-left corner of the
+         * content rectangle; zoom 1 with pan (0, 0) is the plain setBounds()
+         * mapping. Changing either is a transform-only update: the whole
+         * screen is marked damaged so the next frame repaints, but the
+         * world-space geometry is untouched, so edge endpoints are not
+         * recomputed.
+         */
+        double zoom() const;
+        void zoom(double factor);
+        GPoint pan() const;
+        void pan(GPoint worldTopLeft);
+
+        /* Rescales the view to the given zoom factor while holding the given
+         * world point fixed on screen; this is the right primitive for
+         * zooming about the mouse cursor.
+         */
+        void zoomAbout(GPoint worldPt, double factor);
+
         /* Coordinate changes. */
         double     graphicsToWorld(double width);
         GPoint     graphicsToWorld(GPoint pt);
@@ -258,6 +607,20 @@ namespace GraphEditor {
         /* Where we were told to draw. */
         GRectangle rawBounds{0, 0, 0, 0};
 
+        /* Viewport state; see the accessors above. */
+        double mZoom = 1;
+        GPoint mPan { 0, 0 };
+
+        /* Cached composed transform, rebuilt by updateViewTransform() when
+         * the bounds, zoom, or pan change. GMatrix is purely linear, so the
+         * translation rides alongside it; worldToGraphics() is then one
+         * matrix-vector product and an add per point.
+         */
+        GMatrix worldToView { 0, 0, 0, 0 };
+        GMatrix viewToWorld { 0, 0, 0, 0 };
+        GVector viewShift   { 0, 0 };
+        void updateViewTransform();
+
         /* List of all nodes / edges. */
         std::set<std::shared_ptr<Node>> nodes;
 
@@ -271,11 +634,196 @@ namespace GraphEditor {
         /* Available numbers for states; if empty, use size of states
          * as the next free one.
          */
-        std::set<int> freeNodeIDs;
+        IndexPool freeNodeIDs;
+
+        /* Checkpoint history, most recent last; see checkpoint(). */
+        std::vector<Snapshot> checkpoints;
+        std::size_t mCheckpointLimit = kDefaultCheckpointLimit;
+
+        /* Empties the graph and every index built over it, leaving the viewer
+         * ready for a bulk reload. Used by Viewer::restore().
+         */
+        void clearGraph();
 
         /* Graph type. */
         Type mType = Type::DIRECTED;
 
+        /* Batch update state. While updateDepth is nonzero, calls to
+         * calculateEdgeEndpoints() just set the dirty flag; the work happens
+         * once the outermost batch closes.
+         */
+        std::size_t updateDepth = 0;
+        bool edgeEndpointsDirty = false;
+
+        /* Nodes that moved during the current batch, mapped to their positions
+         * as of when the batch opened. Used to drive the incremental recompute
+         * when the batch closes without any structural changes.
+         */
+        std::unordered_map<Node*, GPoint> movedNodes;
+
+        /* Uniform spatial hash over world coordinates, used to answer nodeAt /
+         * edgeAt queries without scanning every entity. Keys are grid cell
+         * coordinates packed into a single integer; values are the entities
+         * overlapping that cell.
+         *
+         * The node grid is maintained eagerly as nodes are added, moved, and
+         * removed. The edge grid is rebuilt lazily on the next query after the
+         * edge renders change, since they change wholesale.
+         */
+        std::unordered_map<long long, std::vector<Node*>> nodeGrid;
+        std::unordered_map<long long, std::vector<Edge*>> edgeGrid;
+        bool edgeGridStale = true;
+
+        void indexNode(Node* node);
+        void unindexNode(Node* node, const GPoint& pos);
+        void rebuildEdgeGrid();
+
+        /* Fills the buffers with the obstacles near enough to constrain a
+         * self-loop around the given node center, via the spatial hashes.
+         */
+        void gatherLoopObstacles(const GPoint& home,
+                                 std::vector<std::pair<GPoint, GPoint>>& lines,
+                                 std::vector<std::pair<GPoint, double>>& circles);
+
+        /* Label -> node index backing nodeLabeled(). A multimap because labels
+         * may legitimately collide; see nodeLabeled() for the lookup policy.
+         */
+        std::unordered_multimap<std::string, Node*> nodesByLabel;
+
+        void indexNodeLabel(Node* node);
+        void unindexNodeLabel(Node* node);
+
+        /* Reverse-adjacency index: for each node, the edges pointing at it.
+         * Along with nodePtrs (raw pointer -> owning shared_ptr), this lets
+         * node removal run in time proportional to the node's degree rather
+         * than the size of the graph.
+         */
+        std::unordered_map<Node*, std::vector<Edge*>> inEdges;
+        std::unordered_map<Node*, std::shared_ptr<Node>> nodePtrs;
+
+        void indexInEdge(Edge* edge);
+        void unindexInEdge(Edge* edge);
+
+        /* Flat entity arrays. Ownership lives in the structures above; these
+         * exist so that the hot loops (drawing, edge geometry, iteration) can
+         * do a linear sweep over contiguous memory instead of chasing through
+         * the node set and the two-level edge map. Removal swap-erases, with
+         * each entity recording its own slot.
+         */
+        std::vector<Node*> nodeList;
+        std::vector<Edge*> edgeList;
+
+        /* Retained styles, slot-parallel to the lists above; see style(). */
+        std::vector<NodeStyle> nodeStyleSlots;
+        std::vector<EdgeStyle> edgeStyleSlots;
+
+        void addNodeToList(Node* node);
+        void removeNodeFromList(Node* node);
+        void addEdgeToList(Edge* edge);
+        void removeEdgeFromList(Edge* edge);
+
+        /* Text-layout caches. Edge labels pay for a UTF-8 rewrite (to
+         * nonbreaking spaces) and a text-shaping pass just to pick a font;
+         * neither depends on anything that changes frame to frame, so both are
+         * memoized here. The caches are cleared wholesale if they grow past a
+         * sanity limit (see the .cpp file).
+         */
+        std::unordered_map<std::string, std::string> nonbreakingCache;
+        std::unordered_map<std::string, MiniGUI::Font> edgeLabelFontCache;
+
+        const std::string& nonbreakingLabelFor(const std::string& text);
+
+        /* Damage state: either everything is damaged (fullDamage), or the
+         * damage is confined to a world-space rectangle accumulated as a
+         * running union. We start fully damaged so the first draw paints
+         * everything.
+         */
+        bool fullDamage = true;
+        bool anyDamage  = true;
+        GRectangle damageBounds{0, 0, 0, 0};
+
+        void markDamaged(Node* node);
+        void markDamaged(Edge* edge);
+        void markDamaged(const GRectangle& worldRect);
+        void markAllDamaged();
+        void clearDamage();
+
+        /* Scene version stamp, bumped whenever damage is recorded. draw()
+         * compares it against the version it last put on the canvas; when
+         * they match and no per-frame style overrides are in play, the
+         * canvas already shows this exact scene and the frame is skipped
+         * outright.
+         */
+        std::uint64_t sceneVersion = 1;
+        std::uint64_t drawnVersion = 0;
+        GCanvas* drawnCanvas = nullptr;
+        bool drawnWithOverrides = false;
+
+        /* Instrumentation state (see PerfStats). */
+        bool mInstrumentationEnabled = false;
+        PerfStats mPerfStats;
+
+        /* Rendering mode state (see RenderMode). */
+        RenderMode mRenderMode = RenderMode::DETAILED;
+        double mSimplificationThreshold = kDefaultSimplificationThreshold;
+
+        /* Worker count for full endpoint recomputation; see endpointThreads(). */
+        unsigned mEndpointThreads = 0;
+
+        /* Set by Viewer when its NodeType is exactly Node. In that case no
+         * override of Node::draw() can exist, so the draw loops may call it
+         * non-virtually. Polymorphic node types keep the virtual path.
+         */
+        bool stockNodeRender = false;
+
+        /* The world-space region currently visible on screen. */
+        GRectangle visibleWorldBounds();
+
+        /* Whether OVERVIEW mode should draw simplified entities at the
+         * current scale.
+         */
+        bool simplifiedAtCurrentScale();
+
+        /* Draws a node as a plain filled disk, with no border or label. */
+        void drawSimplifiedNode(GCanvas* canvas, Node* node, const NodeStyle& style);
+
+        /* Format-neutral decoded form of a saved graph. Both the binary
+         * reader and the streaming JSON reader produce this; the templated
+         * loading constructor then rebuilds typed nodes and edges from it.
+         * Aux payloads ride along as JSON text, empty meaning none, so that
+         * nothing is parsed into a DOM unless it's actually present.
+         */
+        struct NodeRecord {
+            std::size_t index;
+            GPoint pos;
+            std::string label;
+            std::string aux;
+        };
+        struct EdgeRecord {
+            std::size_t from, to;
+            std::string label;
+            std::string aux;
+        };
+        struct GraphData {
+            std::vector<NodeRecord> nodes;
+            std::vector<EdgeRecord> edges;
+            std::string aux;
+            Type type = Type::DIRECTED;
+        };
+        static GraphData readBinary(std::istream& in);
+        static GraphData readStreamedJSON(std::istream& in);
+
+        /* Inverses of the readers: emit a record set in either format. These
+         * back toBinary() and Snapshot; serialize() streams the live graph
+         * directly (it must not materialize a record copy) but produces the
+         * same JSON.
+         */
+        static void writeBinaryRecords(const GraphData& data, std::ostream& out);
+        static void writeJSONRecords(const GraphData& data, std::ostream& out);
+
+        /* One-pass export of the live graph into records. */
+        GraphData exportRecords();
+
         JSON nodesToJSON();
         JSON edgesToJSON();
         JSON typeToJSON();
@@ -284,12 +832,24 @@ namespace GraphEditor {
         JSON toJSON(Edge* edge);
 
         Edge* edgeBetween(Node* from, Node* to);
+
+        /* Finds a node by label in O(1) via the label index. Labels aren't
+         * required to be unique; if several nodes share the label, an arbitrary
+         * one of them is returned.
+         */
         Node* nodeLabeled(const std::string& label);
 
         /* Graphics routines. */
         void drawTransition(GCanvas* canvas, std::shared_ptr<Edge> transition);
 
-        void drawEdgeLabel(GCanvas* canvas, const GPoint& p0, const GPoint& p1,
+        /* Draws an edge label through a caller-owned retained GText. The key
+         * records the inputs the text was last laid out from; when it still
+         * matches, the placement math is skipped and the object is reissued
+         * as-is.
+         */
+        void drawEdgeLabel(GCanvas* canvas,
+                                 GText& retained, std::string& retainedKey,
+                                 const GPoint& p0, const GPoint& p1,
                                  const std::string& label,
                                  MiniGUI::Color color,
                                  bool hugLine);
@@ -299,14 +859,49 @@ namespace GraphEditor {
         /* Recalculates the renderer for each transition. */
         void calculateEdgeEndpoints();
 
+        /* Incremental version of the above. Given the set of nodes that moved
+         * (mapped to their old positions), re-derives renders only for edges
+         * incident to those nodes, plus self-loops whose collision neighborhood
+         * was touched by the change. Falls back to the full recomputation if the
+         * cached geometry isn't usable.
+         */
+        void calculateEdgeEndpointsFor(const std::unordered_map<Node*, GPoint>& moved);
+
+        /* Where a (non-loop) edge's line should start and end. */
+        std::pair<GPoint, GPoint> lineEndpointsOf(Edge* edge);
+
+        /* Point edge->style at a render with the given geometry. If the edge
+         * already has a render of the right kind it's updated in place, so
+         * steady-state endpoint recomputation allocates nothing.
+         */
+        void setLineRender(Edge* edge, const GPoint& from, const GPoint& to);
+        void setLoopRender(Edge* edge, const GPoint& center, const GPoint& arrowPt);
+
         /* Used by subtypes. */
         bool hasEdge(Node* from, Node* to);
         void forEachNode(std::function<void(Node*)>);
         void forEachEdge(std::function<void(Edge*)>);
+
+        /* Templated iteration over the flat entity arrays. Unlike the
+         * std::function versions above, the callback's type is known
+         * statically, so per-entity visitation inlines rather than paying a
+         * type-erased indirect call. Internal hot loops use these.
+         */
+        template <typename Callback> void visitNodes(Callback callback) {
+            for (auto node: nodeList) {
+                callback(node);
+            }
+        }
+        template <typename Callback> void visitEdges(Callback callback) {
+            for (auto edge: edgeList) {
+                callback(edge);
+            }
+        }
         Node* nodeAt(const GPoint& pt);
         Edge* edgeAt(const GPoint& pt);
         void removeEdge(Edge* edge);
 
+        friend struct EdgeRender;
         friend struct LineEdge;
         friend struct LoopEdge;
         friend class  Node;
@@ -316,6 +911,7 @@ namespace GraphEditor {
         friend class Viewer;
 
         friend class EditorBase;
+        friend class LayoutEngine;
         template <typename Viewer> friend class Editor;
     };
 
@@ -332,7 +928,9 @@ namespace GraphEditor {
         using EdgeType = E;
 
         /* Constructs a new, empty viewer. */
-        Viewer() = default;
+        Viewer() {
+            stockNodeRender = std::is_same<NodeType, Node>::value;
+        }
 
         /* Deserializes the viewer from the given JSON data. The JSON data is
          * presumed to have been written by a previous Viewer.
@@ -343,6 +941,12 @@ namespace GraphEditor {
          */
         Viewer(JSON data);
 
+        /* Deserializes the viewer from a stream holding either the JSON
+         * interchange format or the binary format written by toBinary(); the
+         * two are distinguished by the magic bytes at the front.
+         */
+        explicit Viewer(std::istream& in);
+
         NodeType* newNode(const GPoint& location);
         void removeNode(NodeType* state);
         NodeType* nodeLabeled(const std::string& name);
@@ -355,15 +959,54 @@ namespace GraphEditor {
         NodeType* nodeAt(const GPoint& pt);
         EdgeType* edgeAt(const GPoint& pt);
 
-        void forEachNode(std::function<void(NodeType*)>);
-        void forEachEdge(std::function<void(EdgeType*)>);
+        /* Applies the callback to each node/edge. The callback type is a
+         * template parameter rather than a std::function so that the call
+         * inlines; any callable taking a NodeType* / EdgeType* works.
+         */
+        template <typename Callback> void forEachNode(Callback callback);
+        template <typename Callback> void forEachEdge(Callback callback);
 
         EdgeType* edgeBetween(NodeType* from, NodeType* to);
 
+        /* Replaces the graph's contents with those of the given snapshot.
+         * Rebuilding runs through the same bulk-load path as the stream
+         * constructors; no JSON is serialized or parsed along the way.
+         */
+        void restore(const Snapshot& snapshot);
+
+        /* Restores the most recent checkpoint and pops it off the history.
+         * Returns false (and changes nothing) if the history is empty.
+         */
+        bool undo();
+
+        /* Imports a plain-text edge list from the stream, reading it
+         * incrementally: memory grows with the graph, never with the file.
+         * Each nonblank line names one edge as two whitespace-separated node
+         * labels, optionally followed by an edge label (the rest of the
+         * line); lines starting with '#' are comments. Nodes are created on
+         * first mention and scattered deterministically across the world -
+         * run a layout pass afterward for something readable. Edges that
+         * already exist are skipped.
+         *
+         * Every kImportProgressInterval edges, progress is called with the
+         * count read so far; returning false cancels the import, keeping
+         * what was already read. Edge geometry is computed once, at the end.
+         * Returns the number of edges imported.
+         */
+        template <typename Callback>
+        std::size_t importEdgeList(std::istream& in, Callback progress);
+        std::size_t importEdgeList(std::istream& in);
+
     private:
         /* Full constructors. */
         std::shared_ptr<NodeType> newNode(const GPoint& pt, size_t index, const std::string& label, JSON aux);
         std::shared_ptr<EdgeType> newEdge(NodeType* from, NodeType* to, const std::string& label,   JSON aux);
+
+        /* Constructor bodies: one for an already-parsed JSON DOM, one for the
+         * decoded records the stream readers produce.
+         */
+        void loadFromJSON(JSON j);
+        void loadFromRecords(const GraphData& data);
     };
 
 
@@ -399,8 +1042,7 @@ namespace GraphEditor {
         /* Get the ID for this state. */
         size_t id = numNodes();
         if (!freeNodeIDs.empty()) {
-            id = *freeNodeIDs.begin();
-            freeNodeIDs.erase(freeNodeIDs.begin());
+            id = freeNodeIDs.allocate();
         }
 
         auto result = newNode(pt, id, "", nullptr);
@@ -411,6 +1053,8 @@ namespace GraphEditor {
     std::shared_ptr<NodeType> Viewer<NodeType, EdgeType>::newNode(const GPoint& pt, size_t index, const std::string& label, JSON j) {
         auto result = std::shared_ptr<NodeType>(new NodeType(this, NodeArgs{pt, index, label}, j));
         nodes.insert(result);
+        nodePtrs[result.get()] = result;
+        addNodeToList(result.get());
 
         /* Reposition to the point; this forces the point to be in bounds. */
         result->position(pt);
@@ -432,8 +1076,16 @@ namespace GraphEditor {
             std::swap(from, to);
         }
 
+        /* If we're replacing an existing edge, its index entries have to go. */
+        if (auto existing = edges[from][to]) {
+            unindexInEdge(existing.get());
+            removeEdgeFromList(existing.get());
+        }
+
         auto edge = std::shared_ptr<EdgeType>(new EdgeType(this, EdgeArgs{from, to, label}, aux));
         edges[from][to] = edge;
+        indexInEdge(edge.get());
+        addEdgeToList(edge.get());
         calculateEdgeEndpoints();
         return edge;
     }
@@ -450,33 +1102,58 @@ namespace GraphEditor {
 
     template <typename NodeType, typename EdgeType>
     void Viewer<NodeType, EdgeType>::removeNode(NodeType* node) {
-        auto itr = find_if(nodes.begin(), nodes.end(), [&](std::shared_ptr<Node> n) {
-             return n.get() == node;
-        });
-        if (itr == nodes.end()) return;
+        auto itr = nodePtrs.find(node);
+        if (itr == nodePtrs.end()) return;
 
-        /* Remove transitions from the state. */
-        edges.erase(node);
+        /* Hold the node until we're completely done with it; see below. */
+        auto nodePtr = itr->second;
+        nodePtrs.erase(itr);
 
-        /* Remove transitions to the state. */
-        for (auto& e1: edges) {
-            auto itr = e1.second.begin();
-            while (itr != e1.second.end()) {
-                if (itr->first == node) {
-                    itr = e1.second.erase(itr);
-                } else {
-                    ++itr;
+        /* Remove transitions from the state, dropping each from its target's
+         * in-edge list.
+         */
+        auto out = edges.find(node);
+        if (out != edges.end()) {
+            for (const auto& entry: out->second) {
+                if (entry.second) {
+                    unindexInEdge(entry.second.get());
+                    removeEdgeFromList(entry.second.get());
                 }
             }
+            edges.erase(out);
+        }
+
+        /* Remove transitions to the state. The in-edge index tells us exactly
+         * which nodes have edges pointing here, so this costs the node's
+         * in-degree rather than a pass over the whole graph.
+         */
+        auto in = inEdges.find(node);
+        if (in != inEdges.end()) {
+            for (Edge* edge: in->second) {
+                /* The map entry is the edge's last owner, so it has to be the
+                 * final thing we touch: erasing it destroys the edge.
+                 */
+                removeEdgeFromList(edge);
+                edges[edge->from()].erase(node);
+            }
+            inEdges.erase(in);
         }
 
-        freeNodeIDs.insert(node->index());
+        freeNodeIDs.release(node->index());
+
+        /* Pull the node (and, lazily, its edges) out of the spatial hash, and
+         * drop its label index entry.
+         */
+        unindexNode(node, node->position());
+        unindexNodeLabel(node);
+        removeNodeFromList(node);
+        edgeGridStale = true;
 
         /* Only at the very end should we remove the node from the set of nodes.
          * Doing so may break the last pointer to the node, at which point the
          * node becomes invalid.
          */
-        nodes.erase(itr);
+        nodes.erase(nodePtr);
 
         /* Now, recalculate edges without this node present. */
         calculateEdgeEndpoints();
@@ -497,12 +1174,50 @@ namespace GraphEditor {
         return static_cast<NodeType*>(ViewerBase::nodeLabeled(label));
     }
 
-    /* Deserialize. */
+    /* Deserialize. Both constructors delegate to the default constructor so
+     * that it remains the one place viewer-level flags get set up.
+     */
+    template <typename NodeType, typename EdgeType>
+    Viewer<NodeType, EdgeType>::Viewer(JSON j): Viewer() {
+        loadFromJSON(j);
+    }
+
+    template <typename NodeType, typename EdgeType>
+    Viewer<NodeType, EdgeType>::Viewer(std::istream& in): Viewer() {
+        /* Both readers stream the input; at no point is the whole file held
+         * as a JSON DOM.
+         */
+        if (isBinaryFormat(in)) {
+            loadFromRecords(readBinary(in));
+        } else {
+            loadFromRecords(readStreamedJSON(in));
+        }
+    }
+
     template <typename NodeType, typename EdgeType>
-    Viewer<NodeType, EdgeType>::Viewer(JSON j) {
-        /* Decompress nodes. */
+    void Viewer<NodeType, EdgeType>::loadFromJSON(JSON j) {
+        /* Defer edge geometry until the whole graph is in place; otherwise we'd
+         * recompute every edge endpoint once per node and edge created here.
+         */
+        BatchUpdate update(this);
+
+        /* Size our storage up front so that the load below never reallocates. */
+        std::size_t nodeCount = 0;
+        for (JSON jNode: j["nodes"]) {
+            (void) jNode;
+            nodeCount++;
+        }
+        nodeList.reserve(nodeCount);
+        nodePtrs.reserve(nodeCount);
+        nodesByLabel.reserve(nodeCount);
+
+        /* Decompress nodes. The index table is a flat array keyed directly on
+         * node index, which the edge pass below can hit without a map lookup.
+         */
         std::size_t maxIndex = 0;
-        std::map<std::size_t, Node*> byIndex;
+        std::vector<Node*> byIndex;
+        std::vector<std::size_t> usedIndices;
+        usedIndices.reserve(nodeCount);
         for (JSON jNode: j["nodes"]) {
             std::size_t index = jNode["index"].asInteger();
             std::string label = jNode["label"].asString();
@@ -510,26 +1225,35 @@ namespace GraphEditor {
 
             auto node = newNode(pos, index, label, jNode["aux"]);
 
-            byIndex[node->index()] = node.get();
+            if (index >= byIndex.size()) byIndex.resize(index + 1, nullptr);
+            byIndex[index] = node.get();
+            usedIndices.push_back(index);
 
             maxIndex = std::max(maxIndex, index);
         }
 
-        /* Loop over nodes again, filling in missing node IDs. */
-        for (size_t i = 0; i < maxIndex; i++) {
-            freeNodeIDs.insert(i);
-        }
-        for (auto node: nodes) {
-            freeNodeIDs.erase(node->index());
-        }
+        /* Recover the free node IDs in one pass: sort the indices in use and
+         * hand the pool the whole universe at once.
+         */
+        std::sort(usedIndices.begin(), usedIndices.end());
+        freeNodeIDs.setUniverse(maxIndex, usedIndices);
 
         /* Decompress edges. */
         for (JSON jEdge: j["edges"]) {
             std::size_t from  = jEdge["from"].asInteger();
             std::size_t to    = jEdge["to"].asInteger();
             std::string label = jEdge["label"].asString();
-            auto edge         = newEdge(static_cast<NodeType*>(byIndex.at(from)),
-                                        static_cast<NodeType*>(byIndex.at(to)),
+
+            /* As in loadFromRecords(), indices come from a file: an edge
+             * naming a node that doesn't exist means corrupted data.
+             */
+            if (from >= byIndex.size() || !byIndex[from] ||
+                to   >= byIndex.size() || !byIndex[to]) {
+                error("GraphEditor: corrupted graph data; edge references a missing node.");
+            }
+
+            auto edge         = newEdge(static_cast<NodeType*>(byIndex[from]),
+                                        static_cast<NodeType*>(byIndex[to]),
                                         label,
                                         jEdge["aux"]);
         }
@@ -547,16 +1271,151 @@ namespace GraphEditor {
     }
 
     template <typename NodeType, typename EdgeType>
-    void Viewer<NodeType, EdgeType>::forEachNode(std::function<void(NodeType*)> callback) {
-        return ViewerBase::forEachNode([&](Node* node) {
-            return callback(static_cast<NodeType*>(node));
+    void Viewer<NodeType, EdgeType>::loadFromRecords(const GraphData& data) {
+        /* As in the JSON path, defer edge geometry until everything exists. */
+        BatchUpdate update(this);
+
+        /* The type has to be in force before any edge is built: newEdge
+         * honors the viewer's current type, so rebuilding a DIRECTED record
+         * set while still UNDIRECTED would drop self-loops and canonize edge
+         * directions instead of restoring them.
+         */
+        type(data.type);
+
+        nodeList.reserve(data.nodes.size());
+        nodePtrs.reserve(data.nodes.size());
+        nodesByLabel.reserve(data.nodes.size());
+
+        /* Records carry explicit indices, so reconstruct the flat index table
+         * and free-ID set the same way the JSON loader does.
+         */
+        std::size_t maxIndex = 0;
+        std::vector<Node*> byIndex;
+        std::vector<std::size_t> usedIndices;
+        usedIndices.reserve(data.nodes.size());
+        for (const auto& record: data.nodes) {
+            JSON aux = record.aux.empty()? JSON(nullptr) : JSON::parse(record.aux);
+            auto node = newNode(record.pos, record.index, record.label, aux);
+
+            if (record.index >= byIndex.size()) byIndex.resize(record.index + 1, nullptr);
+            byIndex[record.index] = node.get();
+            usedIndices.push_back(record.index);
+
+            maxIndex = std::max(maxIndex, record.index);
+        }
+
+        std::sort(usedIndices.begin(), usedIndices.end());
+        freeNodeIDs.setUniverse(maxIndex, usedIndices);
+
+        for (const auto& record: data.edges) {
+            /* Indices come from a file, so treat them as hostile: an edge
+             * naming a node that doesn't exist means corrupted data, not UB.
+             */
+            if (record.from >= byIndex.size() || !byIndex[record.from] ||
+                record.to   >= byIndex.size() || !byIndex[record.to]) {
+                error("GraphEditor: corrupted graph data; edge references a missing node.");
+            }
+
+            JSON aux = record.aux.empty()? JSON(nullptr) : JSON::parse(record.aux);
+            newEdge(static_cast<NodeType*>(byIndex[record.from]),
+                    static_cast<NodeType*>(byIndex[record.to]),
+                    record.label,
+                    aux);
+        }
+    }
+
+    template <typename NodeType, typename EdgeType>
+    void Viewer<NodeType, EdgeType>::restore(const Snapshot& snapshot) {
+        clearGraph();
+        loadFromRecords(*snapshot.mData);
+    }
+
+    template <typename NodeType, typename EdgeType>
+    template <typename Callback>
+    std::size_t Viewer<NodeType, EdgeType>::importEdgeList(std::istream& in, Callback progress) {
+        /* Defer all edge geometry to the end of the import. */
+        BatchUpdate update(this);
+
+        double worldHeight = 1 / aspectRatio();
+
+        /* Finds the node with the given label, creating it if this is its
+         * first mention. New nodes land on a low-discrepancy sequence over
+         * the world rectangle: deterministic, spread out evenly no matter how
+         * many nodes ultimately arrive, and cheap to compute per node.
+         */
+        std::size_t created = 0;
+        auto nodeFor = [&](const std::string& label) {
+            auto* existing = nodeLabeled(label);
+            if (existing) return existing;
+
+            double tx = std::fmod(0.7548776662466927 * created, 1.0);
+            double ty = std::fmod(0.5698402909980532 * created, 1.0);
+            created++;
+
+            GPoint pos = { 0.05 + 0.90 * tx, (0.05 + 0.90 * ty) * worldHeight };
+            auto* node = newNode(pos);
+            node->label(label);
+            return node;
+        };
+
+        std::size_t edgesRead = 0;
+        std::string line;
+        std::istringstream parser;
+        while (std::getline(in, line)) {
+            parser.clear();
+            parser.str(line);
+
+            std::string from, to;
+            if (!(parser >> from >> to)) continue; // Blank or malformed line.
+            if (from[0] == '#') continue;
+
+            /* Anything left on the line is the edge label. */
+            std::string label;
+            std::getline(parser >> std::ws, label);
+
+            NodeType* src = nodeFor(from);
+            NodeType* dst = nodeFor(to);
+            if (!edgeBetween(src, dst)) newEdge(src, dst, label);
+
+            edgesRead++;
+            if (edgesRead % kImportProgressInterval == 0 && !progress(edgesRead)) {
+                break;
+            }
+        }
+        return edgesRead;
+    }
+
+    template <typename NodeType, typename EdgeType>
+    std::size_t Viewer<NodeType, EdgeType>::importEdgeList(std::istream& in) {
+        return importEdgeList(in, [](std::size_t) { return true; });
+    }
+
+    template <typename NodeType, typename EdgeType>
+    bool Viewer<NodeType, EdgeType>::undo() {
+        if (checkpoints.empty()) return false;
+
+        /* Pop before restoring: restore() must not see the checkpoint we're
+         * unwinding as part of the history.
+         */
+        Snapshot last = checkpoints.back();
+        checkpoints.pop_back();
+        restore(last);
+        return true;
+    }
+
+    template <typename NodeType, typename EdgeType>
+    template <typename Callback>
+    void Viewer<NodeType, EdgeType>::forEachNode(Callback callback) {
+        visitNodes([&](Node* node) {
+            callback(static_cast<NodeType*>(node));
         });
     }
 
     template <typename NodeType, typename EdgeType>
-    void Viewer<NodeType, EdgeType>::forEachEdge(std::function<void(EdgeType*)> callback) {
-        return ViewerBase::forEachEdge([&](Edge* edge) {
-            return callback(static_cast<EdgeType*>(edge));
+    template <typename Callback>
+    void Viewer<NodeType, EdgeType>::forEachEdge(Callback callback) {
+        visitEdges([&](Edge* edge) {
+            callback(static_cast<EdgeType*>(edge));
         });
     }
 }